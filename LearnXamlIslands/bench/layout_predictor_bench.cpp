@@ -0,0 +1,299 @@
+﻿// Replays a drag-resize trace through `layout_predictor` and reports its hit
+// rate and how much UI thread time it costs or saves compared to computing
+// every layout on the UI thread (a negative net UI time means that it saves
+// time). It fails if a layout differs from the one computed on the UI thread.
+// It doesn't depend on Windows:
+//
+//   g++ -std=c++17 -O2 -pthread -o layout_predictor_bench layout_predictor_bench.cpp
+//   ./layout_predictor_bench [trace] [--interval-us=<us>] [--size-delay-us=<us>]
+//       [--threads=<count>] [--lookahead=<count>] [--drag-rects=<count>]
+//
+// The trace is either a Chrome trace recorded with `LEARN_XAML_ISLANDS_TRACE`,
+// whose `layout_sizing` events carry the client size as `width << 16 | height`,
+// or a text file with one `<client width> <client height>` pair per line.
+// Without a trace, a synthetic drag-resize is used.
+
+#include "../layout_predictor.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    struct bench_config
+    {
+        std::string trace_path;
+
+        // Time between two `WM_SIZING`, i.e. between two mouse moves.
+        long interval_us = 8000;
+
+        // Time between a `WM_SIZING` and the `WM_SIZE` that follows it. In the
+        // modal size loop, `WM_SIZE` is sent from within the same call, so
+        // there is no time for the workers in between.
+        long size_delay_us = 0;
+
+        unsigned int threads = 2;
+        int lookahead = 3;
+        int drag_rects = 1;
+    };
+
+    struct size_sample
+    {
+        int width;
+        int height;
+    };
+
+    std::vector<size_sample> load_chrome_trace(const std::string& contents)
+    {
+        std::vector<size_sample> samples;
+
+        const std::string name = "\"layout_sizing\"";
+        const std::string arg = "\"size\":";
+
+        for (auto pos = contents.find(name); pos != std::string::npos; pos = contents.find(name, pos + 1))
+        {
+            const auto arg_pos = contents.find(arg, pos);
+            if (arg_pos == std::string::npos)
+            {
+                break;
+            }
+
+            const auto size = std::stoll(contents.substr(arg_pos + arg.size(), 32));
+            samples.push_back({ static_cast<int>(size >> 16), static_cast<int>(size & 0xFFFF) });
+        }
+
+        return samples;
+    }
+
+    std::vector<size_sample> load_trace(const std::string& path)
+    {
+        std::ifstream in(path);
+        if (!in)
+        {
+            throw std::runtime_error("failed to open " + path);
+        }
+
+        const std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (contents.find("\"traceEvents\"") != std::string::npos)
+        {
+            return load_chrome_trace(contents);
+        }
+
+        std::vector<size_sample> samples;
+        std::istringstream lines(contents);
+        size_sample sample;
+        while (lines >> sample.width >> sample.height)
+        {
+            samples.push_back(sample);
+        }
+
+        return samples;
+    }
+
+    // A user dragging the bottom right corner, speeding up and slowing down,
+    // with some jitter and some pauses.
+    std::vector<size_sample> make_synthetic_trace()
+    {
+        std::vector<size_sample> samples;
+
+        double width = 800.0;
+        double height = 600.0;
+        for (int i = 0; i < 2000; ++i)
+        {
+            const auto speed = 6.0 * std::sin(i / 60.0);
+            width += speed + (i % 7 == 0 ? 1.0 : 0.0);
+            height += speed / 2.0;
+
+            if (i % 250 < 20)
+            {
+                // pause: the size doesn't change
+                width -= speed;
+                height -= speed / 2.0;
+            }
+
+            samples.push_back({ static_cast<int>(width), static_cast<int>(height) });
+        }
+
+        return samples;
+    }
+
+    frame_layout_params make_params(const size_sample& sample)
+    {
+        frame_layout_params params;
+        params.client_width = sample.width;
+        params.client_height = sample.height;
+        params.top_border_height = 1;
+        params.top_resize_handle_height = 8;
+        params.dpi_scale = 1.0f;
+        return params;
+    }
+
+    drag_area_fn make_drag_area(int rect_count)
+    {
+        // Same as the title bar of the application, optionally split around
+        // a number of controls.
+        return [rect_count](int client_width, int /* client_height */, float dpi_scale)
+        {
+            std::vector<layout_rect> rects;
+
+            const auto width = static_cast<int>(client_width * dpi_scale);
+            const auto height = static_cast<int>(50 * dpi_scale);
+            const auto slice = width / rect_count;
+
+            for (int i = 0; i < rect_count; ++i)
+            {
+                const auto left = i * slice;
+                const auto right = i == rect_count - 1 ? width : left + slice - static_cast<int>(40 * dpi_scale);
+                rects.push_back({ left, 0, right, height });
+            }
+
+            return rects;
+        };
+    }
+
+    bench_config parse_args(int argc, char** argv)
+    {
+        bench_config config;
+
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string arg = argv[i];
+            const auto eq = arg.find('=');
+            const auto key = arg.substr(0, eq);
+            const auto value = eq == std::string::npos ? std::string() : arg.substr(eq + 1);
+
+            if (key == "--interval-us")
+            {
+                config.interval_us = std::stol(value);
+            }
+            else if (key == "--size-delay-us")
+            {
+                config.size_delay_us = std::stol(value);
+            }
+            else if (key == "--threads")
+            {
+                config.threads = static_cast<unsigned int>(std::stoul(value));
+            }
+            else if (key == "--lookahead")
+            {
+                config.lookahead = std::stoi(value);
+            }
+            else if (key == "--drag-rects")
+            {
+                config.drag_rects = (std::max)(std::stoi(value), 1);
+            }
+            else if (key.rfind("--", 0) == 0)
+            {
+                throw std::invalid_argument("unknown option " + arg);
+            }
+            else
+            {
+                config.trace_path = arg;
+            }
+        }
+
+        return config;
+    }
+
+    double to_us(std::chrono::nanoseconds time)
+    {
+        return static_cast<double>(time.count()) / 1000.0;
+    }
+
+    struct replay_result
+    {
+        layout_predictor::metrics metrics;
+
+        // Time that the UI thread spent in the predictor, including lookups
+        // and computations after misses.
+        std::chrono::nanoseconds ui_time{ 0 };
+    };
+
+    // Feeds the trace to the predictor at the pace of the messages so that
+    // the UI thread measurements see the same cache state as in the
+    // application, whether there are workers or not.
+    replay_result replay(const std::vector<size_sample>& samples, const bench_config& config, const drag_area_fn& drag_area, unsigned int threads)
+    {
+        layout_predictor predictor(drag_area, threads, config.lookahead);
+
+        replay_result result;
+        for (const auto& sample : samples)
+        {
+            const auto params = make_params(sample);
+
+            auto start = std::chrono::steady_clock::now();
+            predictor.on_sizing(params);
+            result.ui_time += std::chrono::steady_clock::now() - start;
+
+            if (config.size_delay_us > 0)
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(config.size_delay_us));
+            }
+
+            start = std::chrono::steady_clock::now();
+            const auto layout = predictor.get_or_compute(params);
+            result.ui_time += std::chrono::steady_clock::now() - start;
+
+            // A precomputed layout must be the one that the UI thread would
+            // have computed.
+            if (!(layout == compute_frame_layout(params, drag_area)))
+            {
+                throw std::runtime_error("wrong layout for " + std::to_string(sample.width) + "x" + std::to_string(sample.height));
+            }
+
+            std::this_thread::sleep_for(std::chrono::microseconds(config.interval_us));
+        }
+
+        result.metrics = predictor.get_metrics();
+        return result;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        const auto config = parse_args(argc, argv);
+        const auto samples = config.trace_path.empty() ? make_synthetic_trace() : load_trace(config.trace_path);
+        if (samples.empty())
+        {
+            std::cerr << "the trace doesn't contain any size\n";
+            return EXIT_FAILURE;
+        }
+
+        const auto drag_area = make_drag_area(config.drag_rects);
+
+        // Without workers, every layout is computed on the UI thread.
+        const auto baseline = replay(samples, config, drag_area, 0);
+        const auto predicted = replay(samples, config, drag_area, config.threads);
+
+        std::cout << "samples:                   " << samples.size() << '\n'
+            << "hits:                      " << predicted.metrics.hits << '\n';
+
+        for (size_t i = 0; i < predicted.metrics.hits_by_step.size(); ++i)
+        {
+            std::cout << "  extrapolated " << i + 1 << " ahead:    " << predicted.metrics.hits_by_step[i] << '\n';
+        }
+
+        std::cout << "misses:                    " << predicted.metrics.misses << '\n'
+            << "hit rate:                  " << predicted.metrics.hit_rate() * 100.0 << " %\n"
+            << "predictions:               " << predicted.metrics.predictions << '\n'
+            << "UI time without predictor: " << to_us(baseline.ui_time) << " us\n"
+            << "UI time with predictor:    " << to_us(predicted.ui_time) << " us\n"
+            << "net UI time:               " << to_us(predicted.ui_time - baseline.ui_time) << " us\n"
+            << "estimated net UI time:     " << to_us(predicted.metrics.estimated_net_ui_time()) << " us\n";
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,115 @@
+﻿// Checks the frame layout computation and the layout predictor. Like the
+// benchmark, it doesn't depend on Windows:
+//
+//   g++ -std=c++17 -O2 -pthread -o layout_predictor_test layout_predictor_test.cpp
+//   ./layout_predictor_test
+
+#include "../layout_predictor.h"
+
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool condition, const char* what)
+    {
+        if (!condition)
+        {
+            std::cerr << "FAILED: " << what << '\n';
+            ++failures;
+        }
+    }
+
+    frame_layout_params make_params(int client_width, int client_height, bool maximized = false)
+    {
+        frame_layout_params params;
+        params.client_width = client_width;
+        params.client_height = client_height;
+        params.maximized = maximized;
+        params.top_border_height = 1;
+        params.top_resize_handle_height = 8;
+        params.dpi_scale = 1.0f;
+        return params;
+    }
+
+    std::vector<layout_rect> title_bar(int client_width, int /* client_height */, float dpi_scale)
+    {
+        return { { 0, 0, static_cast<int>(client_width * dpi_scale), static_cast<int>(50 * dpi_scale) } };
+    }
+
+    void test_island_rect()
+    {
+        check(compute_island_rect(make_params(800, 600)) == layout_rect{ 0, 1, 800, 600 }, "the island is below the top border");
+        check(compute_island_rect(make_params(800, 600, true)) == layout_rect{ 0, 8, 800, 600 }, "the maximized island is below the resize handle");
+    }
+
+    void test_normalize_drag_rects()
+    {
+        const auto params = make_params(800, 600);
+
+        check(normalize_drag_rects({ { 10, 0, 100, 50 } }, params) == std::vector<layout_rect>{ { 10, 1, 100, 51 } },
+            "rects are moved below the top border");
+        check(normalize_drag_rects({ { -20, -10, 900, 700 } }, params) == std::vector<layout_rect>{ { 0, 0, 800, 600 } },
+            "rects are clipped to the client area");
+        check(normalize_drag_rects({ { 900, 0, 1000, 50 }, { 0, -100, 100, -50 }, { 10, 0, 10, 50 } }, params).empty(),
+            "rects outside of the client area or empty are removed");
+        check(normalize_drag_rects({ { 0, 0, 100, 50 }, { 0, 0, 100, 50 } }, params) == std::vector<layout_rect>{ { 0, 1, 100, 51 } },
+            "only one of duplicated rects is kept");
+        check(normalize_drag_rects({ { 10, 10, 20, 20 }, { 0, 0, 100, 50 } }, params) == std::vector<layout_rect>{ { 0, 1, 100, 51 } },
+            "rects inside of another one are removed");
+        check(normalize_drag_rects({ { 0, 0, 60, 50 }, { 40, 0, 100, 50 } }, params) == std::vector<layout_rect>{ { 0, 1, 60, 51 }, { 40, 1, 100, 51 } },
+            "overlapping rects are kept");
+    }
+
+    void test_predictor()
+    {
+        layout_predictor predictor(title_bar, 1);
+
+        // a steady drag, so every size after the first two was extrapolated
+        for (int i = 0; i < 50; ++i)
+        {
+            const auto params = make_params(800 + 4 * i, 600 + 2 * i);
+            predictor.on_sizing(params);
+            check(predictor.get_or_compute(params) == compute_frame_layout(params, title_bar), "the predictor returns the computed layout");
+        }
+
+        const auto resize = predictor.end_resize();
+        check(resize.hits + resize.misses == 50, "every size is a hit or a miss");
+        check(resize.hits_by_step.size() == 3, "hits are counted for each lookahead step");
+
+        const auto params = make_params(640, 480);
+        predictor.get_or_compute(params);
+        const auto next_resize = predictor.end_resize();
+        check(next_resize.hits == 0 && next_resize.misses == 1, "the metrics of a resize only cover that resize");
+        check(predictor.get_metrics().hits + predictor.get_metrics().misses == 51, "the total metrics cover every resize");
+    }
+
+    void test_predictor_without_workers()
+    {
+        layout_predictor predictor(title_bar, 0);
+
+        const auto params = make_params(800, 600);
+        predictor.on_sizing(params);
+        check(predictor.get_or_compute(params) == compute_frame_layout(params, title_bar), "the layout is computed without workers");
+        check(predictor.get_metrics().misses == 1 && predictor.get_metrics().predictions == 0, "nothing is precomputed without workers");
+    }
+}
+
+int main()
+{
+    test_island_rect();
+    test_normalize_drag_rects();
+    test_predictor();
+    test_predictor_without_workers();
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " check(s) failed\n";
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "all checks passed\n";
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,82 @@
+﻿#pragma once
+
+// Command line parsing helpers. They expect the Windows headers from `pch.h`
+// to be included before them.
+
+inline std::vector<std::wstring> get_command_line_args()
+{
+    int argc = 0;
+    const auto argv = CommandLineToArgvW(GetCommandLine(), &argc);
+    if (argv == NULL)
+    {
+        winrt::throw_last_error();
+    }
+
+    // skip the program name
+    std::vector<std::wstring> args(argv + (argc > 0 ? 1 : 0), argv + argc);
+    LocalFree(argv);
+
+    return args;
+}
+
+inline constexpr const wchar_t* layout_predictor_usage =
+    L"\n"
+    L"other options:\n"
+    L"  --layout-predictor-threads=<count>      precompute the layout on <count>\n"
+    L"                                          threads while resizing (default: 0)\n";
+
+// Returns the number of threads that precompute the layout while resizing, 0
+// (the default) to disable it. Throws `std::invalid_argument` if the option
+// is not valid.
+inline unsigned int parse_layout_predictor_threads(const std::vector<std::wstring>& args)
+{
+    const std::wstring key = L"--layout-predictor-threads=";
+
+    unsigned int threads = 0;
+    for (const auto& arg : args)
+    {
+        if (arg.rfind(key, 0) != 0)
+        {
+            continue;
+        }
+
+        const auto value = arg.substr(key.size());
+        if (value.empty() || value.size() > 2 || !std::all_of(value.begin(), value.end(), [](wchar_t c) { return c >= L'0' && c <= L'9'; }))
+        {
+            throw std::invalid_argument("invalid value for --layout-predictor-threads: \"" + winrt::to_string(value) + "\"");
+        }
+
+        threads = static_cast<unsigned int>(std::stoul(value));
+    }
+
+    return threads;
+}
+
+// This is a GUI application so the message goes to the console that started
+// it, if there is one, and to the debugger output.
+inline void report_error(const std::wstring& message)
+{
+    OutputDebugString(message.c_str());
+
+    if (AttachConsole(ATTACH_PARENT_PROCESS))
+    {
+        const auto console = CreateFile(L"CONOUT$", GENERIC_WRITE, FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
+        if (console != INVALID_HANDLE_VALUE)
+        {
+            DWORD written;
+            WriteConsole(console, message.c_str(), static_cast<DWORD>(message.size()), &written, NULL);
+            CloseHandle(console);
+        }
+
+        FreeConsole();
+    }
+}
+
+inline void report_usage_error(const std::string& error, const wchar_t* usage)
+{
+    std::wstring message(winrt::to_hstring(error));
+    message += L"\n\n";
+    message += usage;
+
+    report_error(message);
+}
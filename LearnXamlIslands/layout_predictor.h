@@ -0,0 +1,455 @@
+﻿#pragma once
+
+// Computation of the frame layout (the island window and the drag windows)
+// and speculative precomputation of it on worker threads during interactive
+// resizing.
+//
+// This file doesn't depend on Windows so that the predictor can be
+// benchmarked on other platforms, see `bench/layout_predictor_bench.cpp`.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct layout_rect
+{
+    int left;
+    int top;
+    int right;
+    int bottom;
+
+    bool is_empty() const noexcept
+    {
+        return right <= left || bottom <= top;
+    }
+
+    bool contains(const layout_rect& other) const noexcept
+    {
+        return other.left >= left && other.right <= right && other.top >= top && other.bottom <= bottom;
+    }
+};
+
+inline bool operator==(const layout_rect& a, const layout_rect& b) noexcept
+{
+    return a.left == b.left && a.top == b.top && a.right == b.right && a.bottom == b.bottom;
+}
+
+// Everything that the frame layout depends on.
+struct frame_layout_params
+{
+    int client_width = 0;
+    int client_height = 0;
+    bool maximized = false;
+    int top_border_height = 0;
+    int top_resize_handle_height = 0;
+    float dpi_scale = 1.0f;
+};
+
+inline bool operator==(const frame_layout_params& a, const frame_layout_params& b) noexcept
+{
+    return a.client_width == b.client_width && a.client_height == b.client_height &&
+        a.maximized == b.maximized && a.top_border_height == b.top_border_height &&
+        a.top_resize_handle_height == b.top_resize_handle_height && a.dpi_scale == b.dpi_scale;
+}
+
+// Returns the drag area for the given client size, in client coordinates
+// without the top border. It is called from worker threads so it must not
+// touch any window.
+using drag_area_fn = std::function<std::vector<layout_rect>(int client_width, int client_height, float dpi_scale)>;
+
+struct frame_layout
+{
+    frame_layout_params params;
+    layout_rect island_rect;
+    std::vector<layout_rect> drag_rects;
+};
+
+inline bool operator==(const frame_layout& a, const frame_layout& b) noexcept
+{
+    return a.params == b.params && a.island_rect == b.island_rect && a.drag_rects == b.drag_rects;
+}
+
+inline layout_rect compute_island_rect(const frame_layout_params& params)
+{
+    layout_rect rect = { 0, 0, params.client_width, params.client_height };
+
+    if (params.maximized)
+    {
+        // When a window is maximized, its size is actually a little bit more
+        // than the monitor's work area. The window is positioned and sized in
+        // such a way that the resize handles are outside of the monitor and
+        // then the window is clipped to the monitor so that the resize handle
+        // do not appear because you don't need them (because you can't resize
+        // a window when it's maximized unless you restore it).
+        rect.top += params.top_resize_handle_height;
+    }
+    else
+    {
+        // we keep a border at the top which imitates the system top border
+        rect.top = params.top_border_height;
+    }
+
+    return rect;
+}
+
+// Moves the drag area below the top border, clips it to the client area and
+// removes the rectangles that would not receive any input.
+inline std::vector<layout_rect> normalize_drag_rects(std::vector<layout_rect> rects, const frame_layout_params& params)
+{
+    for (auto& rect : rects)
+    {
+        rect.top = (std::max)(rect.top + params.top_border_height, 0);
+        rect.bottom = (std::min)(rect.bottom + params.top_border_height, params.client_height);
+        rect.left = (std::max)(rect.left, 0);
+        rect.right = (std::min)(rect.right, params.client_width);
+    }
+
+    rects.erase(std::remove_if(rects.begin(), rects.end(), [](const auto& rect) { return rect.is_empty(); }), rects.end());
+
+    // A rectangle that is inside of another one would only create a window
+    // that is hidden behind the other one.
+    for (size_t i = 0; i < rects.size();)
+    {
+        bool covered = false;
+        for (size_t j = 0; j < rects.size() && !covered; ++j)
+        {
+            covered = j != i && rects[j].contains(rects[i]) && (!(rects[j] == rects[i]) || j < i);
+        }
+
+        if (covered)
+        {
+            rects.erase(rects.begin() + i);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    return rects;
+}
+
+inline frame_layout compute_frame_layout(const frame_layout_params& params, const drag_area_fn& drag_area)
+{
+    return {
+        params,
+        compute_island_rect(params),
+        normalize_drag_rects(drag_area(params.client_width, params.client_height, params.dpi_scale), params),
+    };
+}
+
+// Extrapolates the next client sizes from the recent `WM_SIZING` trajectory
+// and computes the frame layout for them on worker threads, so that the UI
+// thread only has to pick up the result when the `WM_SIZE` matches. It is
+// only meant to be used during the modal size loop, between
+// `WM_ENTERSIZEMOVE` and `WM_EXITSIZEMOVE`: other resizes are not predicted
+// and would only count as misses.
+//
+// The size proposed by a `WM_SIZING` is not precomputed because its `WM_SIZE`
+// is sent from within the same `DefWindowProc` call, before a worker could be
+// done with it.
+class layout_predictor
+{
+public:
+    struct metrics
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+
+        // Hits by how many `WM_SIZING` ahead the size was extrapolated, the
+        // first element being for the next one.
+        std::vector<uint64_t> hits_by_step;
+
+        // Number of layouts computed by the workers, used or not.
+        uint64_t predictions = 0;
+
+        // Time that the UI thread spent in the predictor, including queueing
+        // predictions, looking them up and computing layouts after misses.
+        std::chrono::nanoseconds ui_time{ 0 };
+
+        // Part of `ui_time` spent computing layouts after misses.
+        std::chrono::nanoseconds inline_compute_time{ 0 };
+
+        double hit_rate() const noexcept
+        {
+            const auto total = hits + misses;
+            return total == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(total);
+        }
+
+        // Difference between `ui_time` and the time that computing every
+        // layout on the UI thread would have taken, estimated from the
+        // misses. It is negative when the predictor saves UI thread time, and
+        // zero when there was no miss to estimate from.
+        std::chrono::nanoseconds estimated_net_ui_time() const noexcept
+        {
+            if (misses == 0)
+            {
+                return std::chrono::nanoseconds(0);
+            }
+
+            const auto inline_time = inline_compute_time * static_cast<int64_t>(hits + misses) / static_cast<int64_t>(misses);
+            return ui_time - inline_time;
+        }
+
+        // Returns what was measured since `earlier`.
+        metrics since(const metrics& earlier) const
+        {
+            auto ret = *this;
+            ret.hits -= earlier.hits;
+            ret.misses -= earlier.misses;
+            ret.predictions -= earlier.predictions;
+            ret.ui_time -= earlier.ui_time;
+            ret.inline_compute_time -= earlier.inline_compute_time;
+
+            for (size_t i = 0; i < ret.hits_by_step.size() && i < earlier.hits_by_step.size(); ++i)
+            {
+                ret.hits_by_step[i] -= earlier.hits_by_step[i];
+            }
+
+            return ret;
+        }
+    };
+
+    // `lookahead` is the number of sizes that are extrapolated after each
+    // `WM_SIZING`. Without any worker thread, nothing is precomputed and every
+    // layout is computed by `get_or_compute`.
+    layout_predictor(drag_area_fn drag_area, unsigned int thread_count, int lookahead = 3) :
+        _drag_area(std::move(drag_area)),
+        _lookahead(lookahead)
+    {
+        _metrics.hits_by_step.resize(static_cast<size_t>((std::max)(lookahead, 0)));
+
+        for (unsigned int i = 0; i < thread_count; ++i)
+        {
+            _workers.emplace_back(&layout_predictor::_worker_proc, this);
+        }
+    }
+
+    layout_predictor(const layout_predictor&) = delete;
+    layout_predictor& operator=(const layout_predictor&) = delete;
+
+    ~layout_predictor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _cv.notify_all();
+
+        for (auto& worker : _workers)
+        {
+            worker.join();
+        }
+    }
+
+    // Must be called from the UI thread with the layout parameters of the size
+    // proposed by `WM_SIZING`.
+    void on_sizing(const frame_layout_params& params)
+    {
+        if (_workers.empty())
+        {
+            return;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+
+        const auto has_prev = _has_prev;
+        const auto prev = _prev;
+        _prev = params;
+        _has_prev = true;
+
+        const auto dw = has_prev ? params.client_width - prev.client_width : 0;
+        const auto dh = has_prev ? params.client_height - prev.client_height : 0;
+        if (dw == 0 && dh == 0)
+        {
+            // Either the first sample or the size didn't change, so there is
+            // no trajectory to extrapolate.
+            _ui_time += std::chrono::steady_clock::now() - start;
+            return;
+        }
+
+        size_t queued;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            // Predictions from older samples that were not started yet are
+            // less likely to be right than the new ones.
+            _queue.clear();
+
+            for (int step = 1; step <= _lookahead; ++step)
+            {
+                auto candidate = params;
+                candidate.client_width = (std::max)(params.client_width + dw * step, 0);
+                candidate.client_height = (std::max)(params.client_height + dh * step, 0);
+
+                if (!_is_known(candidate))
+                {
+                    _queue.push_back({ candidate, step });
+                }
+            }
+
+            queued = _queue.size();
+        }
+
+        // Waking up workers is not free, so only wake up as many as needed.
+        for (size_t i = 0; i < queued && i < _workers.size(); ++i)
+        {
+            _cv.notify_one();
+        }
+
+        _ui_time += std::chrono::steady_clock::now() - start;
+    }
+
+    // Must be called from the UI thread when the interactive resize ends.
+    // Returns the metrics of that resize.
+    metrics end_resize()
+    {
+        _has_prev = false;
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _queue.clear();
+            _cache.clear();
+        }
+
+        const auto total = get_metrics();
+        const auto resize = total.since(_metrics_at_last_resize);
+        _metrics_at_last_resize = total;
+
+        return resize;
+    }
+
+    // Returns the precomputed layout for `params` if there is one, otherwise
+    // computes it on the calling thread. Must be called from the UI thread.
+    frame_layout get_or_compute(const frame_layout_params& params)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            const auto it = std::find_if(_cache.begin(), _cache.end(), [&](const auto& cached) { return cached.layout.params == params; });
+            if (it != _cache.end())
+            {
+                auto layout = std::move(it->layout);
+                ++_metrics.hits;
+                ++_metrics.hits_by_step[static_cast<size_t>(it->step - 1)];
+                _cache.erase(it);
+
+                _ui_time += std::chrono::steady_clock::now() - start;
+                return layout;
+            }
+        }
+
+        const auto compute_start = std::chrono::steady_clock::now();
+        auto layout = compute_frame_layout(params, _drag_area);
+        const auto end = std::chrono::steady_clock::now();
+
+        _inline_compute_time += end - compute_start;
+        _ui_time += end - start;
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_metrics.misses;
+
+        return layout;
+    }
+
+    // Must be called from the UI thread.
+    metrics get_metrics() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto ret = _metrics;
+        ret.ui_time = std::chrono::duration_cast<std::chrono::nanoseconds>(_ui_time);
+        ret.inline_compute_time = std::chrono::duration_cast<std::chrono::nanoseconds>(_inline_compute_time);
+
+        return ret;
+    }
+
+private:
+    struct prediction
+    {
+        frame_layout_params params;
+        int step;
+    };
+
+    struct cached_layout
+    {
+        frame_layout layout;
+        int step;
+    };
+
+    // Must be called with `_mutex` held.
+    bool _is_known(const frame_layout_params& params) const
+    {
+        const auto matches = [&](const auto& other) { return other.params == params; };
+
+        return std::any_of(_queue.begin(), _queue.end(), matches) ||
+            std::any_of(_in_flight.begin(), _in_flight.end(), matches) ||
+            std::any_of(_cache.begin(), _cache.end(), [&](const auto& cached) { return cached.layout.params == params; });
+    }
+
+    void _worker_proc()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        while (true)
+        {
+            _cv.wait(lock, [this] { return _stopping || !_queue.empty(); });
+            if (_stopping)
+            {
+                return;
+            }
+
+            const auto job = _queue.front();
+            _queue.pop_front();
+            _in_flight.push_back(job);
+
+            lock.unlock();
+
+            auto layout = compute_frame_layout(job.params, _drag_area);
+
+            lock.lock();
+
+            _in_flight.erase(std::find_if(_in_flight.begin(), _in_flight.end(), [&](const auto& other) { return other.params == job.params; }));
+
+            if (_cache.size() == _max_cached)
+            {
+                _cache.pop_front();
+            }
+            _cache.push_back({ std::move(layout), job.step });
+            ++_metrics.predictions;
+        }
+    }
+
+    static constexpr size_t _max_cached = 16;
+
+    const drag_area_fn _drag_area;
+    const int _lookahead;
+
+    // only accessed from the UI thread
+    frame_layout_params _prev;
+    bool _has_prev = false;
+    std::chrono::steady_clock::duration _ui_time{ 0 };
+    std::chrono::steady_clock::duration _inline_compute_time{ 0 };
+    metrics _metrics_at_last_resize;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _cv;
+    std::deque<prediction> _queue;
+    std::vector<prediction> _in_flight;
+    std::deque<cached_layout> _cache;
+    metrics _metrics;
+    bool _stopping = false;
+
+    // Declared last so that the workers start after everything else is
+    // initialized.
+    std::vector<std::thread> _workers;
+};
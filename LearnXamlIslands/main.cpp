@@ -1,4 +1,8 @@
 ﻿#include "pch.h"
+#include "command_line.h"
+#include "layout_predictor.h"
+#include "message_storm.h"
+#include "trace_recorder.h"
 
 using namespace winrt::Windows::Foundation;
 using namespace winrt::Windows::UI::Xaml;
@@ -76,6 +80,8 @@ public:
 
     win32_window(const window_class& wnd_class, LPCTSTR name, DWORD style, DWORD style_ex, int x, int y, int width, int height, HINSTANCE hinstance, HWND parent_handle = HWND_DESKTOP)
     {
+        trace_scope scope("CreateWindowEx");
+
         const auto ret = CreateWindowEx(style_ex, wnd_class.to_param(), name, style, x, y, width, height, parent_handle, NULL, hinstance, this);
         if (ret == NULL)
         {
@@ -105,6 +111,7 @@ public:
     {
         if (_handle != NULL)
         {
+            trace_scope scope("DestroyWindow");
             winrt::check_bool(DestroyWindow(_handle));
         }
     }
@@ -126,6 +133,7 @@ public:
 
     void update_frame() const
     {
+        trace_scope scope("update_frame");
         winrt::check_bool(SetWindowPos(_handle, NULL, 0, 0, 0, 0, SWP_FRAMECHANGED | SWP_NOSIZE | SWP_NOMOVE | SWP_NOACTIVATE | SWP_NOZORDER | SWP_NOOWNERZORDER | SWP_NOREDRAW));
     }
 
@@ -168,6 +176,8 @@ public:
 
     static LRESULT CALLBACK global_window_proc(_In_ HWND hwnd, _In_ UINT msg, _In_ WPARAM w, _In_ LPARAM l) noexcept
     {
+        trace_scope scope(msg);
+
         if (msg == WM_CREATE)
         {
             const auto owner = reinterpret_cast<LPCREATESTRUCT>(l)->lpCreateParams;
@@ -261,6 +271,16 @@ public:
 
         _xaml_source.Content(grid);
 
+        if (trace_recorder::get().is_enabled())
+        {
+            // Mark XAML layout passes on the timeline so that they can be
+            // correlated with the Win32 messages that triggered them.
+            _layout_updated_revoker = grid.LayoutUpdated(winrt::auto_revoke, [](auto /* sender */, auto /* args */)
+                {
+                    trace_recorder::get().record_instant("xaml_layout_updated");
+                });
+        }
+
         winrt::check_hresult(xaml_source_native->get_WindowHandle(&_island_window_handle));
         _reposition_island_window(true);
     }
@@ -287,45 +307,37 @@ public:
 
     void set_drag_area(const std::vector<RECT>& client_rects)
     {
-        // For some reason, resizing windows doesn't work: the window doesn't
-        // receive messages in the new resized area. However, re-creating a
-        // window fixes it.
-        _drag_windows.clear();
+        trace_scope scope("set_drag_area", "rect_count", static_cast<LONGLONG>(client_rects.size()));
 
-        const auto top_border_height = _get_top_border_height();
+        std::vector<layout_rect> rects;
+        rects.reserve(client_rects.size());
 
         for (const auto& rect : client_rects)
         {
-            int x = rect.left;
-            int y = rect.top + top_border_height;
-            int width = rect.right - rect.left;
-            int height = rect.bottom - rect.top;
+            rects.push_back({ static_cast<int>(rect.left), static_cast<int>(rect.top), static_cast<int>(rect.right), static_cast<int>(rect.bottom) });
+        }
 
-            if (!_drag_wnd_class)
-            {
-                WNDCLASSEX wc = {};
-                wc.cbSize = sizeof(wc);
-                wc.hInstance = _hinstance;
-                wc.lpfnWndProc = win32_window::global_window_proc;
-                wc.style = CS_DBLCLKS;
-                wc.lpszClassName = L"xaml_island_drag_window_class";
+        const auto size = get_size();
+        _create_drag_windows(normalize_drag_rects(std::move(rects), _get_layout_params(size.cx, size.cy)));
+    }
 
-                _drag_wnd_class = std::make_unique<window_class>(&wc, _hinstance);
-            }
+    // Sets the function that gives the drag area for a client size. Unlike
+    // with `set_drag_area`, the drag area then follows the size of the window.
+    // With `predictor_threads` worker threads, the layout is also precomputed
+    // during interactive resizing (see `layout_predictor`). This is disabled
+    // by default because it hasn't been shown to save UI thread time yet.
+    void set_drag_area_cb(drag_area_fn cb, unsigned int predictor_threads = 0)
+    {
+        const auto size = get_size();
+        _apply_layout(compute_frame_layout(_get_layout_params(size.cx, size.cy), cb));
 
-            // Description of window styles:
-            // - Use WS_CLIPSIBLING to clip the XAML Island window to make
-            //   sure that our window is on top of it and receives all mouse
-            //   input.
-            // - WS_EX_LAYERED is required. If it is not present, then for
-            //   some reason, the window will not receive any mouse input.
-            // - WS_EX_NOREDIRECTIONBITMAP makes the window invisible (we
-            //   could also set its opacity to 0 because it's a layered
-            //   window but this is simpler).
-            auto& wnd = _drag_windows.emplace_back(*_drag_wnd_class, L"", WS_CHILD | WS_VISIBLE | WS_CLIPSIBLINGS, WS_EX_LAYERED | WS_EX_NOREDIRECTIONBITMAP, x, y, width, height, _hinstance, _top_window->get_handle());
-            wnd.set_window_proc(std::bind(&xaml_island_window::_drag_window_proc, this, _drag_windows.size() - 1, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
-            wnd.bring_on_top();
-        }
+        _layout_predictor = predictor_threads > 0 ? std::make_unique<layout_predictor>(cb, predictor_threads) : nullptr;
+        _drag_area_cb = std::move(cb);
+    }
+
+    layout_predictor::metrics get_layout_predictor_metrics() const
+    {
+        return _layout_predictor ? _layout_predictor->get_metrics() : layout_predictor::metrics();
     }
 
     void set_resize_cb(std::function<void(int new_width, int new_height)> cb)
@@ -343,6 +355,24 @@ public:
         return _top_window->get_dpi_scale();
     }
 
+    HWND get_handle() const noexcept
+    {
+        return _top_window->get_handle();
+    }
+
+    std::vector<HWND> get_drag_window_handles() const
+    {
+        std::vector<HWND> handles;
+        handles.reserve(_drag_windows.size());
+
+        for (const auto& wnd : _drag_windows)
+        {
+            handles.push_back(wnd.get_handle());
+        }
+
+        return handles;
+    }
+
 private:
     LRESULT _top_window_proc(_In_ UINT msg, _In_ WPARAM w, _In_ LPARAM l) noexcept
     {
@@ -386,14 +416,73 @@ private:
             }
             break;
         }
+        case WM_SIZING:
+            if (_layout_predictor || trace_recorder::get().is_enabled())
+            {
+                const auto proposed_rect = reinterpret_cast<const RECT*>(l);
+
+                RECT window_rect;
+                RECT client_rect;
+                if (GetWindowRect(_top_window->get_handle(), &window_rect) && GetClientRect(_top_window->get_handle(), &client_rect))
+                {
+                    // The non-client frame keeps the same size while resizing.
+                    const auto frame_width = (window_rect.right - window_rect.left) - client_rect.right;
+                    const auto frame_height = (window_rect.bottom - window_rect.top) - client_rect.bottom;
+
+                    const auto client_width = proposed_rect->right - proposed_rect->left - frame_width;
+                    const auto client_height = proposed_rect->bottom - proposed_rect->top - frame_height;
+
+                    // Recorded so that traces can be replayed by the layout
+                    // predictor benchmark.
+                    trace_recorder::get().record_instant("layout_sizing", "size", (static_cast<LONGLONG>(client_width) << 16) | (client_height & 0xFFFF));
+
+                    if (_layout_predictor && _in_size_move)
+                    {
+                        // Only the size changes while resizing, and querying
+                        // the system for the rest would cost more than the
+                        // layout itself.
+                        auto params = _last_layout_params;
+                        params.client_width = client_width;
+                        params.client_height = client_height;
+                        params.maximized = false;
+                        _layout_predictor->on_sizing(params);
+                    }
+                }
+            }
+            break;
+        case WM_ENTERSIZEMOVE:
+            _in_size_move = true;
+            break;
+        case WM_EXITSIZEMOVE:
+            _in_size_move = false;
+            if (_layout_predictor)
+            {
+                _report_layout_predictor_metrics(_layout_predictor->end_resize());
+            }
+            break;
         case WM_SIZE:
             if (_island_window_handle != NULL)
             {
-                _reposition_island_window();
+                // Only the sizes of the modal size loop are predicted, the
+                // other ones (e.g. maximizing or `SetWindowPos`) would only
+                // be misses.
+                if (_layout_predictor && _in_size_move)
+                {
+                    _apply_layout(_layout_predictor->get_or_compute(_get_layout_params(LOWORD(l), HIWORD(l))));
+                }
+                else if (_drag_area_cb)
+                {
+                    _apply_layout(compute_frame_layout(_get_layout_params(LOWORD(l), HIWORD(l)), _drag_area_cb));
+                }
+                else
+                {
+                    _reposition_island_window();
+                }
             }
             
             if (_resize_cb)
             {
+                trace_scope scope("resize_cb");
                 _resize_cb(LOWORD(l), HIWORD(l));
             }
 
@@ -563,45 +652,129 @@ private:
             }
         }
 
+        trace_scope scope("DwmExtendFrameIntoClientArea");
+
         // TODO: log errors
         DwmExtendFrameIntoClientArea(_top_window->get_handle(), &margins);
     }
 
     void _reposition_island_window(bool show = false) const
     {
-        RECT island_rc;
-        winrt::check_bool(GetClientRect(_top_window->get_handle(), &island_rc));
+        trace_scope scope("_reposition_island_window");
 
-        WINDOWPLACEMENT placement;
-        if (GetWindowPlacement(_top_window->get_handle(), &placement) && placement.showCmd == SW_SHOWMAXIMIZED)
+        RECT client_rc;
+        winrt::check_bool(GetClientRect(_top_window->get_handle(), &client_rc));
+
+        _move_island_window(compute_island_rect(_get_layout_params(client_rc.right - client_rc.left, client_rc.bottom - client_rc.top)), show);
+    }
+
+    void _move_island_window(const layout_rect& island_rect, bool show) const
+    {
+        int x = island_rect.left;
+        int y = island_rect.top;
+        int width = island_rect.right - island_rect.left;
+        int height = island_rect.bottom - island_rect.top;
+
+        if (show)
         {
-            // When a window is maximized, its size is actually a little bit more
-            // than the monitor's work area. The window is positioned and sized in
-            // such a way that the resize handles are outside of the monitor and
-            // then the window is clipped to the monitor so that the resize handle
-            // do not appear because you don't need them (because you can't resize
-            // a window when it's maximized unless you restore it).
-            island_rc.top += _get_top_resize_handle_height();
+            winrt::check_bool(SetWindowPos(_island_window_handle, HWND_BOTTOM, x, y, width, height, SWP_SHOWWINDOW | SWP_NOACTIVATE | SWP_NOOWNERZORDER | SWP_NOREDRAW));
         }
         else
         {
-            // we keep a border at the top which imitates the system top border
-            island_rc.top = _get_top_border_height();
+            winrt::check_bool(MoveWindow(_island_window_handle, x, y, width, height, FALSE));
         }
+    }
 
-        int x = island_rc.left;
-        int y = island_rc.top;
-        int width = island_rc.right - island_rc.left;
-        int height = island_rc.bottom - island_rc.top;
+    void _create_drag_windows(const std::vector<layout_rect>& rects)
+    {
+        trace_scope scope("_create_drag_windows", "rect_count", static_cast<LONGLONG>(rects.size()));
 
-        if (show)
+        // For some reason, resizing windows doesn't work: the window doesn't
+        // receive messages in the new resized area. However, re-creating a
+        // window fixes it.
+        _drag_windows.clear();
+
+        for (const auto& rect : rects)
         {
-            winrt::check_bool(SetWindowPos(_island_window_handle, HWND_BOTTOM, x, y, width, height, SWP_SHOWWINDOW | SWP_NOACTIVATE | SWP_NOOWNERZORDER | SWP_NOREDRAW));
+            int x = rect.left;
+            int y = rect.top;
+            int width = rect.right - rect.left;
+            int height = rect.bottom - rect.top;
+
+            if (!_drag_wnd_class)
+            {
+                WNDCLASSEX wc = {};
+                wc.cbSize = sizeof(wc);
+                wc.hInstance = _hinstance;
+                wc.lpfnWndProc = win32_window::global_window_proc;
+                wc.style = CS_DBLCLKS;
+                wc.lpszClassName = L"xaml_island_drag_window_class";
+
+                _drag_wnd_class = std::make_unique<window_class>(&wc, _hinstance);
+            }
+
+            // Description of window styles:
+            // - Use WS_CLIPSIBLING to clip the XAML Island window to make
+            //   sure that our window is on top of it and receives all mouse
+            //   input.
+            // - WS_EX_LAYERED is required. If it is not present, then for
+            //   some reason, the window will not receive any mouse input.
+            // - WS_EX_NOREDIRECTIONBITMAP makes the window invisible (we
+            //   could also set its opacity to 0 because it's a layered
+            //   window but this is simpler).
+            auto& wnd = _drag_windows.emplace_back(*_drag_wnd_class, L"", WS_CHILD | WS_VISIBLE | WS_CLIPSIBLINGS, WS_EX_LAYERED | WS_EX_NOREDIRECTIONBITMAP, x, y, width, height, _hinstance, _top_window->get_handle());
+            wnd.set_window_proc(std::bind(&xaml_island_window::_drag_window_proc, this, _drag_windows.size() - 1, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+            wnd.bring_on_top();
         }
-        else
+    }
+
+    void _apply_layout(const frame_layout& layout)
+    {
+        trace_scope scope("_apply_layout");
+
+        _move_island_window(layout.island_rect, false);
+        _create_drag_windows(layout.drag_rects);
+
+        _last_layout_params = layout.params;
+    }
+
+    // Reports the metrics of an interactive resize so that real drags can be
+    // measured, as trace counters and to the debugger output.
+    static void _report_layout_predictor_metrics(const layout_predictor::metrics& metrics)
+    {
+        if (metrics.hits + metrics.misses == 0)
         {
-            winrt::check_bool(MoveWindow(_island_window_handle, x, y, width, height, FALSE));
+            // the window was only moved
+            return;
         }
+
+        const auto net_ui_time_us = std::chrono::duration_cast<std::chrono::microseconds>(metrics.estimated_net_ui_time()).count();
+
+        auto& recorder = trace_recorder::get();
+        recorder.record_counter("layout_predictor", "hits", static_cast<LONGLONG>(metrics.hits));
+        recorder.record_counter("layout_predictor", "misses", static_cast<LONGLONG>(metrics.misses));
+        recorder.record_counter("layout_predictor", "estimated_net_ui_time_us", static_cast<LONGLONG>(net_ui_time_us));
+
+        std::wostringstream message;
+        message << std::fixed << std::setprecision(1)
+            << L"LearnXamlIslands: layout predictor: hits " << metrics.hits << L", misses " << metrics.misses
+            << L", hit rate " << metrics.hit_rate() * 100.0 << L"%, estimated net UI time " << net_ui_time_us << L" us\n";
+        OutputDebugString(message.str().c_str());
+    }
+
+    frame_layout_params _get_layout_params(int client_width, int client_height) const
+    {
+        frame_layout_params params;
+        params.client_width = client_width;
+        params.client_height = client_height;
+        params.top_border_height = _get_top_border_height();
+        params.top_resize_handle_height = _get_top_resize_handle_height();
+        params.dpi_scale = get_dpi_scale();
+
+        WINDOWPLACEMENT placement;
+        params.maximized = GetWindowPlacement(_top_window->get_handle(), &placement) && placement.showCmd == SW_SHOWMAXIMIZED;
+
+        return params;
     }
 
     int _get_top_border_height() const
@@ -640,7 +813,12 @@ private:
     HWND _island_window_handle = NULL;
     DesktopWindowXamlSource _xaml_source;
     Button::Click_revoker _close_btn_click_revoker;
+    FrameworkElement::LayoutUpdated_revoker _layout_updated_revoker;
     std::function<void(int new_width, int new_height)> _resize_cb;
+    drag_area_fn _drag_area_cb;
+    frame_layout_params _last_layout_params;
+    bool _in_size_move = false;
+    std::unique_ptr<layout_predictor> _layout_predictor;
 };
 
 std::unique_ptr<window_class> xaml_island_window::_top_wnd_class;
@@ -648,12 +826,35 @@ std::unique_ptr<window_class> xaml_island_window::_drag_wnd_class;
 HCURSOR xaml_island_window::_normal_cursor = xaml_island_window::_load_cursor(OCR_NORMAL);
 HCURSOR xaml_island_window::_vertical_resize_cursor = xaml_island_window::_load_cursor(OCR_SIZENS);
 
+// Returns `false` if the trace could not be exported, in which case the
+// reason is sent to the debugger output.
+bool export_trace()
+{
+    std::wstring error;
+    if (trace_recorder::get().export_chrome_trace(error))
+    {
+        return true;
+    }
+
+    OutputDebugString((L"LearnXamlIslands: " + error + L"\n").c_str());
+    return false;
+}
+
 int run_msg_loop()
 {
     MSG msg;
 
     while (GetMessage(&msg, NULL, 0, 0))
     {
+        // F12 would be simpler but it breaks into the debugger when one is
+        // attached.
+        if (msg.message == WM_KEYDOWN && msg.wParam == 'T' && GetKeyState(VK_CONTROL) < 0 && GetKeyState(VK_SHIFT) < 0)
+        {
+            export_trace();
+        }
+
+        trace_scope scope("dispatch_message", "msg", msg.message);
+
         TranslateMessage(&msg);
         DispatchMessage(&msg);
     }
@@ -666,20 +867,74 @@ int WINAPI wWinMain(_In_ HINSTANCE hinstance, _In_opt_ HINSTANCE, _In_ LPWSTR, _
 {
     winrt::init_apartment(winrt::apartment_type::single_threaded);
 
+    // The first call returns the size of the path including the terminating
+    // null character, the second one its length.
+    const auto trace_path_size = GetEnvironmentVariable(L"LEARN_XAML_ISLANDS_TRACE", NULL, 0);
+    if (trace_path_size > 1)
+    {
+        std::wstring trace_path(trace_path_size, L'\0');
+        const auto trace_path_len = GetEnvironmentVariable(L"LEARN_XAML_ISLANDS_TRACE", trace_path.data(), trace_path_size);
+        if (trace_path_len == 0 || trace_path_len >= trace_path_size)
+        {
+            OutputDebugString(L"LearnXamlIslands: failed to read LEARN_XAML_ISLANDS_TRACE, tracing is disabled\n");
+        }
+        else
+        {
+            trace_path.resize(trace_path_len);
+            trace_recorder::get().enable(std::move(trace_path));
+        }
+    }
+
+    std::optional<message_storm_config> soak_config;
+    unsigned int layout_predictor_threads = 0;
+    try
+    {
+        const auto args = get_command_line_args();
+        soak_config = message_storm_config::parse(args);
+        layout_predictor_threads = parse_layout_predictor_threads(args);
+    }
+    catch (const std::invalid_argument& e)
+    {
+        report_usage_error(e.what(), (std::wstring(message_storm_config::usage) + layout_predictor_usage).c_str());
+        return 2;
+    }
+
     xaml_island_window wnd(hinstance);
     wnd.set_extend_title_bar_into_client_area(true);
 
-    const auto size = wnd.get_size();
-    const auto scale = wnd.get_dpi_scale();
-    wnd.set_drag_area({ {0, 0, static_cast<LONG>(size.cx * scale), static_cast<LONG>(50 * scale)} });
+    wnd.set_drag_area_cb([](int client_width, int /* client_height */, float dpi_scale) -> std::vector<layout_rect>
+        {
+            return { { 0, 0, static_cast<int>(client_width * dpi_scale), static_cast<int>(50 * dpi_scale) } };
+        }, layout_predictor_threads);
 
-    wnd.set_resize_cb([&](auto new_width, auto /* new_height */)
+    if (soak_config)
+    {
+        // The window is never shown so that the load generator can run
+        // headlessly, unless `maximize` is added to the mix.
+        message_storm<xaml_island_window> storm(wnd, *soak_config);
+
+        bool passed = false;
+        try
+        {
+            passed = storm.run();
+        }
+        catch (const std::runtime_error& e)
         {
-            const auto scale = wnd.get_dpi_scale();
-            wnd.set_drag_area({ {0, 0, static_cast<LONG>(new_width * scale), static_cast<LONG>(50 * scale)} });
-        });
+            report_error(L"LearnXamlIslands: " + std::wstring(winrt::to_hstring(e.what())) + L"\n");
+        }
+
+        const auto exported = export_trace();
+
+        return passed && exported ? 0 : 1;
+    }
 
     wnd.show(cmd_show);
 
-    return run_msg_loop();
+    const auto exit_code = run_msg_loop();
+    if (!export_trace() && exit_code == 0)
+    {
+        return 1;
+    }
+
+    return exit_code;
 }
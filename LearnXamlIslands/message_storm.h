@@ -0,0 +1,700 @@
+﻿#pragma once
+
+// Headless load generator for the soak test. It expects the Windows headers
+// from `pch.h` to be included before it.
+
+#include "layout_predictor.h"
+#include "trace_recorder.h"
+
+// Configuration of the message storm load generator, parsed from the command
+// line, e.g.:
+//
+//   LearnXamlIslands.exe --soak --soak-duration=3600 --soak-rate=2000
+//       --soak-mix=hit_test:50,set_cursor:20,resize:15,drag:10,dpi_change:2
+struct message_storm_config
+{
+    enum op
+    {
+        op_hit_test,
+        op_set_cursor,
+        op_resize,
+        op_interactive_resize,
+        op_drag,
+        op_maximize,
+        op_dpi_change,
+        op_count,
+    };
+
+    static constexpr const char* op_names[op_count] = { "hit_test", "set_cursor", "resize", "interactive_resize", "drag", "maximize", "dpi_change" };
+
+    // Zero means that operations are generated as fast as possible.
+    double ops_per_second = 1000.0;
+    double duration_seconds = 60.0;
+    double sample_interval_seconds = 1.0;
+    // `maximize` is not in the default mix because maximizing the window
+    // makes the system show it.
+    std::array<double, op_count> mix = { 50.0, 20.0, 10.0, 5.0, 10.0, 0.0, 2.0 };
+    unsigned int seed = 0;
+
+    // Allowed growth between the first and the last sample before the run is
+    // considered as leaking.
+    long max_user_object_growth = 50;
+    long max_gdi_object_growth = 50;
+    long max_handle_growth = 100;
+    long max_private_kb_growth = 64 * 1024;
+
+    std::wstring report_path = L"soak_report.csv";
+
+    static constexpr const wchar_t* usage =
+        L"usage: LearnXamlIslands.exe --soak [options]\n"
+        L"  --soak-duration=<seconds>               (default: 60)\n"
+        L"  --soak-rate=<operations per second>     (default: 1000, 0 for no limit)\n"
+        L"  --soak-sample-interval=<seconds>        (default: 1)\n"
+        L"  --soak-mix=<op>:<weight>,...            ops: hit_test, set_cursor, resize,\n"
+        L"                                          interactive_resize, drag, maximize,\n"
+        L"                                          dpi_change\n"
+        L"  --soak-seed=<seed>\n"
+        L"  --soak-max-user-object-growth=<count>   (default: 50)\n"
+        L"  --soak-max-gdi-object-growth=<count>    (default: 50)\n"
+        L"  --soak-max-handle-growth=<count>        (default: 100)\n"
+        L"  --soak-max-private-kb-growth=<KiB>      (default: 65536)\n"
+        L"  --soak-report=<path>                    (default: soak_report.csv)\n";
+
+    // Returns an empty value if the load generator was not requested. Throws
+    // `std::invalid_argument` with a description of the problem if an option
+    // is not valid.
+    static std::optional<message_storm_config> parse(const std::vector<std::wstring>& args)
+    {
+        std::optional<message_storm_config> config;
+
+        for (const auto& arg : args)
+        {
+            const auto eq = arg.find(L'=');
+            const auto key = arg.substr(0, eq);
+            const auto value = eq == std::wstring::npos ? std::wstring() : arg.substr(eq + 1);
+
+            if (key == L"--soak")
+            {
+                config.emplace();
+            }
+            else if (key.rfind(L"--soak-", 0) != 0)
+            {
+                continue;
+            }
+            else if (!config)
+            {
+                throw std::invalid_argument("--soak-* options require --soak");
+            }
+            else if (key == L"--soak-rate")
+            {
+                config->ops_per_second = _parse_double(key, value, 0.0);
+            }
+            else if (key == L"--soak-duration")
+            {
+                config->duration_seconds = _parse_double(key, value, 0.0);
+            }
+            else if (key == L"--soak-sample-interval")
+            {
+                config->sample_interval_seconds = _parse_double(key, value, 0.001);
+            }
+            else if (key == L"--soak-mix")
+            {
+                config->_parse_mix(value);
+            }
+            else if (key == L"--soak-seed")
+            {
+                config->seed = static_cast<unsigned int>(_parse_unsigned(key, value, UINT_MAX));
+            }
+            else if (key == L"--soak-max-user-object-growth")
+            {
+                config->max_user_object_growth = static_cast<long>(_parse_unsigned(key, value, LONG_MAX));
+            }
+            else if (key == L"--soak-max-gdi-object-growth")
+            {
+                config->max_gdi_object_growth = static_cast<long>(_parse_unsigned(key, value, LONG_MAX));
+            }
+            else if (key == L"--soak-max-handle-growth")
+            {
+                config->max_handle_growth = static_cast<long>(_parse_unsigned(key, value, LONG_MAX));
+            }
+            else if (key == L"--soak-max-private-kb-growth")
+            {
+                config->max_private_kb_growth = static_cast<long>(_parse_unsigned(key, value, LONG_MAX));
+            }
+            else if (key == L"--soak-report")
+            {
+                if (value.empty())
+                {
+                    throw std::invalid_argument("--soak-report requires a path");
+                }
+
+                config->report_path = value;
+            }
+            else
+            {
+                throw std::invalid_argument("unknown option " + winrt::to_string(key));
+            }
+        }
+
+        return config;
+    }
+
+private:
+    static double _parse_double(const std::wstring& key, const std::wstring& value, double min)
+    {
+        size_t parsed = 0;
+        double ret = 0.0;
+
+        try
+        {
+            ret = std::stod(value, &parsed);
+        }
+        catch (const std::logic_error&)
+        {
+            parsed = 0;
+        }
+
+        if (parsed == 0 || parsed != value.size() || !(ret >= min))
+        {
+            throw std::invalid_argument("invalid value for " + winrt::to_string(key) + ": \"" + winrt::to_string(value) + "\"");
+        }
+
+        return ret;
+    }
+
+    static unsigned long _parse_unsigned(const std::wstring& key, const std::wstring& value, unsigned long max)
+    {
+        size_t parsed = 0;
+        unsigned long ret = 0;
+
+        // `std::stoul` skips white space and accepts a sign.
+        if (!value.empty() && value[0] >= L'0' && value[0] <= L'9')
+        {
+            try
+            {
+                ret = std::stoul(value, &parsed);
+            }
+            catch (const std::logic_error&)
+            {
+                parsed = 0;
+            }
+        }
+
+        if (parsed == 0 || parsed != value.size() || ret > max)
+        {
+            throw std::invalid_argument("invalid value for " + winrt::to_string(key) + ": \"" + winrt::to_string(value) + "\"");
+        }
+
+        return ret;
+    }
+
+    void _parse_mix(const std::wstring& value)
+    {
+        mix.fill(0.0);
+
+        std::wistringstream entries(value);
+        std::wstring entry;
+        while (std::getline(entries, entry, L','))
+        {
+            const auto colon = entry.find(L':');
+            if (colon == std::wstring::npos)
+            {
+                throw std::invalid_argument("--soak-mix entries must be <op>:<weight>");
+            }
+
+            const auto name = winrt::to_string(entry.substr(0, colon));
+            const auto it = std::find_if(std::begin(op_names), std::end(op_names), [&](auto op_name) { return name == op_name; });
+            if (it == std::end(op_names))
+            {
+                throw std::invalid_argument("unknown --soak-mix operation " + name);
+            }
+
+            mix[it - std::begin(op_names)] = _parse_double(L"--soak-mix " + entry.substr(0, colon), entry.substr(colon + 1), 0.0);
+        }
+
+        if (std::all_of(mix.begin(), mix.end(), [](auto weight) { return weight == 0.0; }))
+        {
+            throw std::invalid_argument("--soak-mix needs at least one operation with a non-zero weight");
+        }
+    }
+};
+
+// Fixed-size histogram of latencies with logarithmic buckets, so that
+// recording latencies for hours doesn't grow the memory that the load
+// generator is measuring. Percentiles are accurate to about 9%.
+class latency_histogram
+{
+public:
+    void record(double latency_us) noexcept
+    {
+        ++_buckets[_get_bucket(latency_us)];
+        ++_count;
+        _max_us = (std::max)(_max_us, latency_us);
+    }
+
+    void merge(const latency_histogram& other) noexcept
+    {
+        for (size_t i = 0; i < _bucket_count; ++i)
+        {
+            _buckets[i] += other._buckets[i];
+        }
+
+        _count += other._count;
+        _max_us = (std::max)(_max_us, other._max_us);
+    }
+
+    void clear() noexcept
+    {
+        _buckets.fill(0);
+        _count = 0;
+        _max_us = 0.0;
+    }
+
+    UINT64 get_count() const noexcept
+    {
+        return _count;
+    }
+
+    // Returns the upper bound of the bucket that contains the percentile.
+    double percentile(double p) const noexcept
+    {
+        if (_count == 0)
+        {
+            return 0.0;
+        }
+
+        const auto rank = (std::max)(static_cast<UINT64>(std::ceil(p * static_cast<double>(_count))), UINT64{ 1 });
+
+        UINT64 seen = 0;
+        for (size_t i = 0; i < _bucket_count; ++i)
+        {
+            seen += _buckets[i];
+            if (seen >= rank)
+            {
+                // the last bucket has no upper bound
+                return i == _bucket_count - 1 ? _max_us : (std::min)(_get_bucket_upper_bound(i), _max_us);
+            }
+        }
+
+        return _max_us;
+    }
+
+    double get_max() const noexcept
+    {
+        return _max_us;
+    }
+
+private:
+    // Bucket 0 is for latencies below 1 us and each following bucket is
+    // 2^(1/8) times wider than the previous one, which covers up to about
+    // 2^30 us (18 minutes).
+    static constexpr size_t _buckets_per_doubling = 8;
+    static constexpr size_t _bucket_count = 1 + 30 * _buckets_per_doubling;
+
+    static size_t _get_bucket(double latency_us) noexcept
+    {
+        if (!(latency_us >= 1.0))
+        {
+            return 0;
+        }
+
+        const auto index = 1 + static_cast<size_t>(std::log2(latency_us) * _buckets_per_doubling);
+        return (std::min)(index, _bucket_count - 1);
+    }
+
+    static double _get_bucket_upper_bound(size_t bucket) noexcept
+    {
+        return std::exp2(static_cast<double>(bucket) / _buckets_per_doubling);
+    }
+
+    std::array<UINT64, _bucket_count> _buckets = {};
+    UINT64 _count = 0;
+    double _max_us = 0.0;
+};
+
+// Drives the window with a synthetic mix of window messages at a controlled
+// rate without any user interaction, and periodically reports throughput,
+// latency and resource usage to a CSV file.
+//
+// Each operation is sent synchronously and the queued messages that it causes
+// (e.g. `WM_SYSCOMMAND` posted by the drag window) are dispatched before it is
+// considered as complete, so the latency covers the whole handling of it.
+//
+// `Window` is `xaml_island_window`. It is only a template parameter so that
+// this header doesn't depend on main.cpp.
+template <typename Window>
+class message_storm
+{
+public:
+    message_storm(const Window& wnd, const message_storm_config& config) :
+        _wnd(wnd),
+        _config(config),
+        _rng(config.seed),
+        _op_dist(config.mix.begin(), config.mix.end())
+    {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        _ticks_per_second = static_cast<double>(frequency.QuadPart);
+    }
+
+    message_storm(const message_storm&) = delete;
+    message_storm& operator=(const message_storm&) = delete;
+
+    // Returns `false` if resource growth exceeded the configured thresholds or
+    // if the application was asked to quit during the run. Throws
+    // `std::runtime_error` if the report could not be written.
+    bool run()
+    {
+        errno = 0;
+        std::ofstream report(_config.report_path, std::ios::out | std::ios::trunc);
+        if (!report)
+        {
+            _throw_report_error("failed to open");
+        }
+
+        report << std::fixed << std::setprecision(1);
+        report << "elapsed_s,ops,ops_per_s,p50_us,p99_us,p999_us,max_us,windows,user_objects,gdi_objects,handles,private_kb\n";
+
+        const auto start = trace_recorder::now();
+        const auto end = start + _to_ticks(_config.duration_seconds);
+        const auto op_interval = _config.ops_per_second > 0.0 ? _to_ticks(1.0 / _config.ops_per_second) : 0;
+        const auto sample_interval = _to_ticks(_config.sample_interval_seconds);
+
+        auto next_op = start;
+        auto next_sample = start + sample_interval;
+        auto last_row = start;
+        UINT64 total_ops = 0;
+        latency_histogram latencies;
+        latency_histogram all_latencies;
+
+        // Growth is measured from the first sample taken during the run so
+        // that what the first operations allocate once doesn't count as a
+        // leak. If the run is shorter than the sample interval, it is measured
+        // from before the run instead.
+        const auto initial_sample = _sample_resources();
+        std::optional<resource_sample> first_sample;
+
+        bool quit = false;
+        for (auto now = start; now < end && !quit; now = trace_recorder::now())
+        {
+            if (now < next_op)
+            {
+                _wait_until(next_op);
+                continue;
+            }
+
+            // Latency is measured from when the operation was scheduled so that
+            // stalls of the window procedure also count for the operations
+            // that had to wait for them, which are then sent back to back.
+            const auto scheduled = op_interval > 0 ? next_op : now;
+            next_op += op_interval;
+
+            const auto op = static_cast<message_storm_config::op>(_op_dist(_rng));
+            {
+                trace_scope scope(message_storm_config::op_names[op]);
+                _run_op(op);
+                quit = !_pump_messages();
+            }
+
+            latencies.record(static_cast<double>(trace_recorder::now() - scheduled) * 1'000'000.0 / _ticks_per_second);
+            ++total_ops;
+
+            if (now >= next_sample)
+            {
+                const auto sample = _sample_resources();
+                if (!first_sample)
+                {
+                    first_sample = sample;
+                }
+
+                // After a stall, the row covers the whole stall and the next
+                // row starts after it, so the rate is computed from the actual
+                // time that the row covers.
+                const auto row_end = trace_recorder::now();
+                const auto elapsed = static_cast<double>(row_end - start) / _ticks_per_second;
+                const auto row_seconds = static_cast<double>(row_end - last_row) / _ticks_per_second;
+                _write_row(report, elapsed, total_ops, static_cast<double>(latencies.get_count()) / row_seconds, latencies, sample);
+
+                all_latencies.merge(latencies);
+                latencies.clear();
+                last_row = row_end;
+                next_sample += ((row_end - next_sample) / sample_interval + 1) * sample_interval;
+            }
+        }
+
+        all_latencies.merge(latencies);
+        const auto last_sample = _sample_resources();
+        const auto& baseline = first_sample ? *first_sample : initial_sample;
+
+        const auto elapsed = static_cast<double>(trace_recorder::now() - start) / _ticks_per_second;
+        report << "# total\n";
+        _write_row(report, elapsed, total_ops, static_cast<double>(total_ops) / elapsed, all_latencies, last_sample);
+        report << "# drag commands: " << _drag_commands << '\n';
+
+        bool passed = !quit;
+        passed &= _check_growth(report, "user_objects", baseline.user_objects, last_sample.user_objects, _config.max_user_object_growth);
+        passed &= _check_growth(report, "gdi_objects", baseline.gdi_objects, last_sample.gdi_objects, _config.max_gdi_object_growth);
+        passed &= _check_growth(report, "handles", baseline.handles, last_sample.handles, _config.max_handle_growth);
+        passed &= _check_growth(report, "private_kb", baseline.private_kb, last_sample.private_kb, _config.max_private_kb_growth);
+        const auto predictor = _wnd.get_layout_predictor_metrics();
+        if (predictor.hits + predictor.misses > 0)
+        {
+            report << "# layout predictor: hits " << predictor.hits << ", misses " << predictor.misses
+                << ", hit rate " << predictor.hit_rate() * 100.0 << "%, predictions " << predictor.predictions
+                << ", UI time " << static_cast<double>(predictor.ui_time.count()) / 1000.0 << " us"
+                << ", estimated net UI time " << static_cast<double>(predictor.estimated_net_ui_time().count()) / 1000.0 << " us\n";
+        }
+
+        report << "# result: " << (passed ? "pass" : "fail") << '\n';
+
+        errno = 0;
+        report.close();
+        if (!report)
+        {
+            _throw_report_error("failed to write");
+        }
+
+        return passed;
+    }
+
+private:
+    struct resource_sample
+    {
+        long windows;
+        long user_objects;
+        long gdi_objects;
+        long handles;
+        long private_kb;
+    };
+
+    // iostreams don't report why they failed, but the C runtime that they
+    // use sets `errno` in most cases.
+    [[noreturn]] void _throw_report_error(const char* what) const
+    {
+        auto error = std::string(what) + " soak report " + winrt::to_string(_config.report_path);
+
+        const auto error_number = errno;
+        if (error_number != 0)
+        {
+            error += ": " + std::generic_category().message(error_number);
+        }
+
+        throw std::runtime_error(error);
+    }
+
+    void _run_op(message_storm_config::op op)
+    {
+        const auto top = _wnd.get_handle();
+
+        RECT window_rect;
+        winrt::check_bool(GetWindowRect(top, &window_rect));
+
+        switch (op)
+        {
+        case message_storm_config::op_hit_test:
+        {
+            const auto pt = _random_point(window_rect);
+            SendMessage(top, WM_NCHITTEST, 0, MAKELPARAM(pt.x, pt.y));
+            break;
+        }
+        case message_storm_config::op_set_cursor:
+            SendMessage(top, WM_SETCURSOR, reinterpret_cast<WPARAM>(top), MAKELPARAM(HTCLIENT, WM_MOUSEMOVE));
+            break;
+        case message_storm_config::op_resize:
+        {
+            std::uniform_int_distribution<int> width_dist(400, 1600);
+            std::uniform_int_distribution<int> height_dist(300, 1000);
+            winrt::check_bool(SetWindowPos(top, NULL, 0, 0, width_dist(_rng), height_dist(_rng), SWP_NOMOVE | SWP_NOZORDER | SWP_NOACTIVATE | SWP_NOOWNERZORDER));
+            break;
+        }
+        case message_storm_config::op_interactive_resize:
+        {
+            // Imitates a short drag-resize with the bottom right handle: the
+            // system enters the modal size loop and, for each mouse move,
+            // sends `WM_SIZING` with the proposed rectangle and then resizes
+            // the window to it.
+            SendMessage(top, WM_ENTERSIZEMOVE, 0, 0);
+
+            RECT rect = window_rect;
+            for (int i = 0; i < _interactive_resize_steps; ++i)
+            {
+                if (rect.right - rect.left >= 1600 || rect.bottom - rect.top >= 1000)
+                {
+                    _interactive_resize_step = -8;
+                }
+                else if (rect.right - rect.left <= 400 || rect.bottom - rect.top <= 300)
+                {
+                    _interactive_resize_step = 8;
+                }
+
+                rect.right += _interactive_resize_step;
+                rect.bottom += _interactive_resize_step / 2;
+                SendMessage(top, WM_SIZING, WMSZ_BOTTOMRIGHT, reinterpret_cast<LPARAM>(&rect));
+                winrt::check_bool(SetWindowPos(top, NULL, 0, 0, rect.right - rect.left, rect.bottom - rect.top, SWP_NOMOVE | SWP_NOZORDER | SWP_NOACTIVATE | SWP_NOOWNERZORDER));
+            }
+
+            SendMessage(top, WM_EXITSIZEMOVE, 0, 0);
+            break;
+        }
+        case message_storm_config::op_drag:
+        {
+            const auto drag_windows = _wnd.get_drag_window_handles();
+            if (drag_windows.empty())
+            {
+                break;
+            }
+
+            const auto drag_window = drag_windows[std::uniform_int_distribution<size_t>(0, drag_windows.size() - 1)(_rng)];
+
+            RECT client_rect;
+            winrt::check_bool(GetClientRect(drag_window, &client_rect));
+            const auto client_pt = _random_point(client_rect);
+
+            // The drag window hit-tests the point and posts the
+            // `WM_SYSCOMMAND` that starts moving or resizing the window,
+            // which `_pump_messages` then drops.
+            SendMessage(drag_window, WM_LBUTTONDOWN, MK_LBUTTON, MAKELPARAM(client_pt.x, client_pt.y));
+            break;
+        }
+        case message_storm_config::op_maximize:
+        {
+            // Goes through the drag window's double click handling, which
+            // alternates between maximizing and restoring the window. This
+            // shows the window.
+            const auto drag_windows = _wnd.get_drag_window_handles();
+            if (!drag_windows.empty())
+            {
+                SendMessage(drag_windows.front(), WM_LBUTTONDBLCLK, MK_LBUTTON, MAKELPARAM(1, 1));
+            }
+            break;
+        }
+        case message_storm_config::op_dpi_change:
+        {
+            // Pretend that the window moved to a monitor with the same DPI so
+            // that the whole `WM_DPICHANGED` path runs without changing the
+            // scale of the window.
+            const auto dpi = GetDpiForWindow(top);
+            RECT suggested_rect = window_rect;
+            suggested_rect.right += _dpi_change_toggle ? 1 : -1;
+            _dpi_change_toggle = !_dpi_change_toggle;
+            SendMessage(top, WM_DPICHANGED, MAKEWPARAM(dpi, dpi), reinterpret_cast<LPARAM>(&suggested_rect));
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    // Returns `false` if `WM_QUIT` was received.
+    bool _pump_messages()
+    {
+        MSG msg;
+        while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
+        {
+            if (msg.message == WM_QUIT)
+            {
+                return false;
+            }
+
+            if (msg.message == WM_SYSCOMMAND && msg.hwnd == _wnd.get_handle())
+            {
+                // Moving or resizing would enter a modal loop that waits for
+                // the mouse button, which is never released.
+                const auto cmd = msg.wParam & 0xFFF0;
+                if (cmd == SC_MOVE || cmd == SC_SIZE)
+                {
+                    ++_drag_commands;
+                    continue;
+                }
+            }
+
+            TranslateMessage(&msg);
+            DispatchMessage(&msg);
+        }
+
+        return true;
+    }
+
+    void _wait_until(LONGLONG deadline)
+    {
+        // `Sleep` has a granularity of about a millisecond, so spin for the
+        // last part of the wait.
+        const auto remaining_ms = static_cast<double>(deadline - trace_recorder::now()) * 1000.0 / _ticks_per_second;
+        if (remaining_ms > 2.0)
+        {
+            Sleep(1);
+        }
+        else
+        {
+            YieldProcessor();
+        }
+    }
+
+    resource_sample _sample_resources() const
+    {
+        const auto process = GetCurrentProcess();
+
+        long windows = 1;
+        EnumChildWindows(_wnd.get_handle(), [](HWND, LPARAM l) -> BOOL
+            {
+                ++*reinterpret_cast<long*>(l);
+                return TRUE;
+            }, reinterpret_cast<LPARAM>(&windows));
+
+        DWORD handles = 0;
+        winrt::check_bool(GetProcessHandleCount(process, &handles));
+
+        PROCESS_MEMORY_COUNTERS_EX memory = {};
+        memory.cb = sizeof(memory);
+        winrt::check_bool(GetProcessMemoryInfo(process, reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&memory), sizeof(memory)));
+
+        return {
+            windows,
+            static_cast<long>(GetGuiResources(process, GR_USEROBJECTS)),
+            static_cast<long>(GetGuiResources(process, GR_GDIOBJECTS)),
+            static_cast<long>(handles),
+            static_cast<long>(memory.PrivateUsage / 1024),
+        };
+    }
+
+    void _write_row(std::ostream& report, double elapsed, UINT64 ops, double ops_per_second, const latency_histogram& latencies, const resource_sample& sample) const
+    {
+        report << elapsed << ',' << ops << ',' << ops_per_second << ','
+            << latencies.percentile(0.5) << ',' << latencies.percentile(0.99) << ','
+            << latencies.percentile(0.999) << ',' << latencies.get_max() << ','
+            << sample.windows << ',' << sample.user_objects << ',' << sample.gdi_objects << ','
+            << sample.handles << ',' << sample.private_kb << '\n';
+    }
+
+    static bool _check_growth(std::ostream& report, const char* name, long first, long last, long max_growth)
+    {
+        const auto growth = last - first;
+        const auto passed = growth <= max_growth;
+
+        report << "# " << name << " growth: " << growth << " (max " << max_growth << ")" << (passed ? "" : " EXCEEDED") << '\n';
+
+        return passed;
+    }
+
+    POINT _random_point(const RECT& rect)
+    {
+        std::uniform_int_distribution<LONG> x_dist(rect.left, (std::max)(rect.left, rect.right - 1));
+        std::uniform_int_distribution<LONG> y_dist(rect.top, (std::max)(rect.top, rect.bottom - 1));
+        return { x_dist(_rng), y_dist(_rng) };
+    }
+
+    LONGLONG _to_ticks(double seconds) const
+    {
+        return static_cast<LONGLONG>(seconds * _ticks_per_second);
+    }
+
+    const Window& _wnd;
+    const message_storm_config& _config;
+    std::mt19937 _rng;
+    std::discrete_distribution<int> _op_dist;
+    double _ticks_per_second;
+    bool _dpi_change_toggle = false;
+    static constexpr int _interactive_resize_steps = 8;
+    int _interactive_resize_step = 8;
+    UINT64 _drag_commands = 0;
+};
@@ -4,6 +4,8 @@
 #include <Windows.h>
 #include <Windowsx.h>
 #include <dwmapi.h>
+#include <Psapi.h>
+#include <shellapi.h>
 #include <winrt/Windows.Foundation.h>
 #include <winrt/Windows.Foundation.Collections.h>
 #include <winrt/Windows.UI.Xaml.h>
@@ -13,9 +15,21 @@
 #include <winrt/Windows.UI.Xaml.Media.h>
 #include <windows.ui.xaml.hosting.desktopwindowxamlsource.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <fstream>
 #include <functional>
+#include <iomanip>
 #include <memory>
 #include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
 #include <vector>
 #include <utility>
 #include <string>
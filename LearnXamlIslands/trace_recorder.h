@@ -0,0 +1,296 @@
+﻿#pragma once
+
+// Timeline of the UI thread activity. It expects the Windows headers from
+// `pch.h` to be included before it.
+
+// Records spans of UI thread activity into a fixed-size ring buffer and
+// exports them as Chrome trace-event JSON, which can be opened in Perfetto
+// (https://ui.perfetto.dev) or in chrome://tracing.
+//
+// Tracing is enabled by setting the `LEARN_XAML_ISLANDS_TRACE` environment
+// variable to the path of the file to write to. The trace is exported when
+// Ctrl+Shift+T is pressed and when the application exits. When tracing is
+// disabled, recording a span costs a single relaxed atomic load.
+class trace_recorder
+{
+public:
+    trace_recorder(const trace_recorder&) = delete;
+    trace_recorder& operator=(const trace_recorder&) = delete;
+
+    static trace_recorder& get() noexcept
+    {
+        static trace_recorder recorder;
+        return recorder;
+    }
+
+    static LONGLONG now() noexcept
+    {
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+        return counter.QuadPart;
+    }
+
+    // Must be called before any event is recorded.
+    void enable(std::wstring path)
+    {
+        _path = std::move(path);
+        _slots = std::make_unique<slot[]>(_capacity);
+        _enabled.store(true, std::memory_order_release);
+    }
+
+    bool is_enabled() const noexcept
+    {
+        return _enabled.load(std::memory_order_relaxed);
+    }
+
+    void record_span(const char* name, LONGLONG start, LONGLONG end, const char* arg_name = nullptr, LONGLONG arg_value = 0) noexcept
+    {
+        if (is_enabled())
+        {
+            _record({ name, 'X', GetCurrentThreadId(), start, end - start, arg_name, arg_value });
+        }
+    }
+
+    void record_instant(const char* name, const char* arg_name = nullptr, LONGLONG arg_value = 0) noexcept
+    {
+        if (is_enabled())
+        {
+            _record({ name, 'i', GetCurrentThreadId(), now(), 0, arg_name, arg_value });
+        }
+    }
+
+    // Records the value of the `series` of the counter `name`, which the trace
+    // viewers plot over time.
+    void record_counter(const char* name, const char* series, LONGLONG value) noexcept
+    {
+        if (is_enabled())
+        {
+            _record({ name, 'C', GetCurrentThreadId(), now(), 0, series, value });
+        }
+    }
+
+    // Returns `false` if tracing is enabled but the trace could not be
+    // written, in which case `error` describes why.
+    bool export_chrome_trace(std::wstring& error) const
+    {
+        if (!is_enabled())
+        {
+            return true;
+        }
+
+        errno = 0;
+        std::ofstream out(_path, std::ios::out | std::ios::trunc);
+        if (!out)
+        {
+            error = _get_export_error(L"failed to open");
+            return false;
+        }
+
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        const auto ticks_to_us = 1'000'000.0 / static_cast<double>(frequency.QuadPart);
+
+        const auto pid = GetCurrentProcessId();
+        const auto end = _next.load(std::memory_order_acquire);
+        const auto begin = end > _capacity ? end - _capacity : 0;
+
+        out << std::fixed << std::setprecision(3);
+        out << "{\"traceEvents\":[";
+
+        bool first = true;
+        for (auto i = begin; i < end; ++i)
+        {
+            const auto& s = _slots[i % _capacity];
+
+            // Skip slots that are being written to or that have already been
+            // overwritten by a newer event.
+            if (s.sequence.load(std::memory_order_acquire) != i + 1)
+            {
+                continue;
+            }
+
+            const auto e = s.data;
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (s.sequence.load(std::memory_order_relaxed) != i + 1)
+            {
+                continue;
+            }
+
+            if (!first)
+            {
+                out << ',';
+            }
+            first = false;
+
+            // Event names are string literals so they don't need escaping.
+            out << "{\"name\":\"" << e.name << "\",\"cat\":\"ui\",\"ph\":\"" << e.phase << '"'
+                << ",\"ts\":" << static_cast<double>(e.start) * ticks_to_us
+                << ",\"pid\":" << pid << ",\"tid\":" << e.thread_id;
+
+            if (e.phase == 'X')
+            {
+                out << ",\"dur\":" << static_cast<double>(e.duration) * ticks_to_us;
+            }
+            else if (e.phase == 'i')
+            {
+                // thread-scoped instant event
+                out << ",\"s\":\"t\"";
+            }
+
+            if (e.arg_name != nullptr)
+            {
+                out << ",\"args\":{\"" << e.arg_name << "\":" << e.arg_value << '}';
+            }
+
+            out << '}';
+        }
+
+        out << "],\"displayTimeUnit\":\"ms\"}";
+
+        errno = 0;
+        out.close();
+        if (!out)
+        {
+            error = _get_export_error(L"failed to write");
+            return false;
+        }
+
+        return true;
+    }
+
+private:
+    struct event
+    {
+        const char* name;
+        char phase;
+        DWORD thread_id;
+        LONGLONG start;
+        LONGLONG duration;
+        const char* arg_name;
+        LONGLONG arg_value;
+    };
+
+    struct slot
+    {
+        // Index of the event stored in this slot plus one, or zero if the slot
+        // is being written to.
+        std::atomic<UINT64> sequence{ 0 };
+        event data = {};
+    };
+
+    trace_recorder()
+    {
+    }
+
+    // iostreams don't report why they failed, but the C runtime that they
+    // use sets `errno` in most cases.
+    std::wstring _get_export_error(const wchar_t* what) const
+    {
+        auto error = std::wstring(what) + L" trace file " + _path;
+
+        const auto error_number = errno;
+        wchar_t description[256];
+        if (error_number != 0 && _wcserror_s(description, error_number) == 0)
+        {
+            error += L": ";
+            error += description;
+        }
+
+        return error;
+    }
+
+    void _record(const event& e) noexcept
+    {
+        const auto index = _next.fetch_add(1, std::memory_order_relaxed);
+        auto& s = _slots[index % _capacity];
+
+        s.sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        s.data = e;
+        s.sequence.store(index + 1, std::memory_order_release);
+    }
+
+    static constexpr UINT64 _capacity = 1 << 16;
+
+    std::atomic<bool> _enabled{ false };
+    std::atomic<UINT64> _next{ 0 };
+    std::unique_ptr<slot[]> _slots;
+    std::wstring _path;
+};
+
+inline const char* get_trace_msg_name(UINT msg) noexcept
+{
+    switch (msg)
+    {
+    case WM_CREATE: return "WM_CREATE";
+    case WM_DESTROY: return "WM_DESTROY";
+    case WM_SIZE: return "WM_SIZE";
+    case WM_SIZING: return "WM_SIZING";
+    case WM_MOVE: return "WM_MOVE";
+    case WM_WINDOWPOSCHANGING: return "WM_WINDOWPOSCHANGING";
+    case WM_WINDOWPOSCHANGED: return "WM_WINDOWPOSCHANGED";
+    case WM_ENTERSIZEMOVE: return "WM_ENTERSIZEMOVE";
+    case WM_EXITSIZEMOVE: return "WM_EXITSIZEMOVE";
+    case WM_NCCALCSIZE: return "WM_NCCALCSIZE";
+    case WM_NCHITTEST: return "WM_NCHITTEST";
+    case WM_NCPAINT: return "WM_NCPAINT";
+    case WM_NCACTIVATE: return "WM_NCACTIVATE";
+    case WM_SETCURSOR: return "WM_SETCURSOR";
+    case WM_DPICHANGED: return "WM_DPICHANGED";
+    case WM_PAINT: return "WM_PAINT";
+    case WM_ERASEBKGND: return "WM_ERASEBKGND";
+    case WM_MOUSEMOVE: return "WM_MOUSEMOVE";
+    case WM_LBUTTONDOWN: return "WM_LBUTTONDOWN";
+    case WM_LBUTTONDBLCLK: return "WM_LBUTTONDBLCLK";
+    case WM_SYSCOMMAND: return "WM_SYSCOMMAND";
+    case WM_CLOSE: return "WM_CLOSE";
+    default: return "window_proc";
+    }
+}
+
+// Records a span covering the lifetime of the object if tracing is enabled.
+class trace_scope
+{
+public:
+    trace_scope(const char* name, const char* arg_name = nullptr, LONGLONG arg_value = 0) noexcept
+    {
+        if (trace_recorder::get().is_enabled())
+        {
+            _name = name;
+            _arg_name = arg_name;
+            _arg_value = arg_value;
+            _start = trace_recorder::now();
+        }
+    }
+
+    // Records a span named after the window message `msg`. The name is only
+    // looked up if tracing is enabled.
+    explicit trace_scope(UINT msg) noexcept
+    {
+        if (trace_recorder::get().is_enabled())
+        {
+            _name = get_trace_msg_name(msg);
+            _arg_name = "msg";
+            _arg_value = msg;
+            _start = trace_recorder::now();
+        }
+    }
+
+    trace_scope(const trace_scope&) = delete;
+    trace_scope& operator=(const trace_scope&) = delete;
+
+    ~trace_scope()
+    {
+        if (_name != nullptr)
+        {
+            trace_recorder::get().record_span(_name, _start, trace_recorder::now(), _arg_name, _arg_value);
+        }
+    }
+
+private:
+    const char* _name = nullptr;
+    const char* _arg_name = nullptr;
+    LONGLONG _arg_value = 0;
+    LONGLONG _start = 0;
+};